@@ -31,15 +31,10 @@ private:
   ~StatusMonitor();
   StatusMonitor(const StatusMonitor &);
   StatusMonitor &operator=(const StatusMonitor &);
-  void runner();
-
-  float precision(float f, int places);
-  void Conv_Signal2Status(StatusSignalWarning &signal,
-                          StatusMonitorWarning &warning);
+  /* adapter over StatusMonitorTemplate with runtime configuration */
   struct StatusMonitorMainHandler;
 
   StatusMonitorMainHandler *main_handler_ = nullptr;
-  StatusMonitorReporterCallback reporter_ = nullptr;
 };
 
 } // namespace CameraService
@@ -53,6 +53,12 @@ public:
     uint32_t width = 0;
     uint32_t height = 0;
     float bitrate = 0;
+    /* max deviation from frame interval still treated as sync, 0: default */
+    uint32_t sync_tolerance_us = 0;
+    /* heart beat report period, 0: default 100ms. heart beats run on one
+     * monitor wide schedule, pipelines with the same period are reported in
+     * the same callback */
+    uint32_t heartbeat_period_us = 0;
   };
 
   struct StatusMonitorWarning {
@@ -77,9 +83,11 @@ public:
 
   struct StatusMonitorFrame {
     std::string pipeline_name;
-    uint64_t sensor_timestamp_us;
-    uint64_t receive_timestamp_us;
-    uint64_t publish_timestamp_us;
+    uint64_t sensor_timestamp_us = 0;
+    /* frame sync is measured between consecutive receive timestamps, keep
+     * them on one steady time base. 0: monitor drain time is used instead */
+    uint64_t receive_timestamp_us = 0;
+    uint64_t publish_timestamp_us = 0;
   };
 
   struct StatusMonitorReport {
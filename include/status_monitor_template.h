@@ -0,0 +1,587 @@
+/*****************************************************************************
+ * Copyright (C) 2022 Momenta Technology Co., Ltd. All rights reserved.
+ *
+ * No.58 Qinglonggang Rd, Suzhou, Jiangsu, PR China, contact@momenta.ai
+ *
+ * https://www.momenta.cn/
+ *
+ * Filename         : status_monitor_template.h
+ * Description      : policy based status monitor, configuration known at
+ *                    build time is resolved at compile time
+ *****************************************************************************/
+
+#pragma once
+#include "status_monitor_base.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <pthread.h>
+#include <queue>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <unordered_set>
+#include <vector>
+
+namespace CameraService {
+namespace detail {
+static const uint32_t PIPELINE_DEFAULT_FPS = 10;
+static const uint32_t PIPELINE_MAX_FPS = 1000;
+static const uint32_t DEFAULT_SYNC_TOLERANCE_US = 1000;
+static const uint32_t DEFAULT_HEARTBEAT_PERIOD_US = 100 * 1000;
+
+inline const std::map<std::string,
+                      StatusMonitorAbstract::STATUS_MONITOR_WARNING> &
+camera_service_monitor_status_map() {
+  static const std::map<std::string,
+                        StatusMonitorAbstract::STATUS_MONITOR_WARNING>
+      CAMERA_SERVICE_MONITOR_STATUS_MAP = {
+          {"ok", StatusMonitorAbstract::SM_STATUS_OK},
+          {"lock_lost", StatusMonitorAbstract::SM_LOCK_LOST},
+          {"encode_error", StatusMonitorAbstract::SM_ENCODE_ERROR},
+          {"hal_lost", StatusMonitorAbstract::SM_DRIVER_ERROR},
+          {"read_timeout", StatusMonitorAbstract::SM_FRAME_LOSS},
+          {"delay", StatusMonitorAbstract::SM_STATUS_DELAY},
+          {"black", StatusMonitorAbstract::SM_DRIVER_ERROR},
+          {"change", StatusMonitorAbstract::SM_HARDWARE_CHANGED},
+          {"calib_missing", StatusMonitorAbstract::SM_CALIB_LOST},
+          {"init_error", StatusMonitorAbstract::SM_INIT_FAIL},
+          {"sedres_lock", StatusMonitorAbstract::SM_SEDERS_LOCK}};
+  return CAMERA_SERVICE_MONITOR_STATUS_MAP;
+}
+
+/* convert camera status string to warning, false if status is unknown */
+inline bool
+Conv_Signal2Status(const StatusMonitorAbstract::StatusSignalWarning &signal,
+                   StatusMonitorAbstract::StatusMonitorWarning &warning) {
+  const std::map<std::string, StatusMonitorAbstract::STATUS_MONITOR_WARNING>
+      &status_map = camera_service_monitor_status_map();
+  warning.timestamp_us = signal.timestamp_us;
+  warning.pipeline_name = signal.pipeline_name;
+  if (status_map.find(signal.camera_status) == status_map.end()) {
+    printf("camera name %s  status %s not found in CAMERA_SERVICE_STATUS_MAP\n",
+           signal.pipeline_name.c_str(), signal.camera_status.c_str());
+    return false;
+  }
+  warning.warning = status_map.at(signal.camera_status);
+  return true;
+}
+
+struct PipelineHandler {
+  StatusMonitorAbstract::PipelineInformation meta;
+  double frame_interval_us = 0;
+  uint64_t sync_tolerance_us = 0;
+  uint64_t heartbeat_period_us = 0;
+  uint64_t pipeline_start_time_us = 0;
+  uint64_t heartbeat_slot = 0; // heart beat periods since monitor origin
+  uint64_t latest_frame_timestamp_us = 0;
+  uint64_t last_sync_timestamp_us = 0;
+  uint64_t seq = 0;
+  uint64_t frame_count_start_time_us = 0;
+  uint32_t frame_count = 0;
+  uint32_t actual_fps = 0;
+  bool sync = false;
+  bool online = false;
+  uint64_t delay_us = 0;
+  std::unordered_set<StatusMonitorAbstract::StatusMonitorWarning,
+                     StatusMonitorAbstract::StatusMonitorWarningHashFunc>
+      camera_status_set;
+};
+
+struct NullMutex {
+  void lock() {}
+  void unlock() {}
+};
+} // namespace detail
+
+/*
+ * clock policy: static uint64_t now_us() monotonic time for interval,
+ * heart beat and frame loss math, static uint64_t wall_time_us() epoch
+ * time for timestamps in reports
+ */
+/* monotonic clock, not affected by system time adjustment (NTP etc.) */
+struct SteadyClockPolicy {
+  static uint64_t now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+  static uint64_t wall_time_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+  }
+};
+
+/*
+ * queue policy: static const bool THREAD_SAFE, Mutex type guarding
+ * pipelines, and Queue<T> with void push(const T &) / bool pop(T &)
+ */
+/* signal() may be called from any thread */
+struct MutexQueuePolicy {
+  static const bool THREAD_SAFE = true;
+  using Mutex = std::mutex;
+  template <typename T> class Queue {
+  public:
+    void push(const T &value) {
+      std::lock_guard<std::mutex> lg(lock_);
+      queue_.push(value);
+    }
+    bool pop(T &value) {
+      std::lock_guard<std::mutex> lg(lock_);
+      if (queue_.empty()) {
+        return false;
+      }
+      value = queue_.front();
+      queue_.pop();
+      return true;
+    }
+
+  private:
+    std::mutex lock_;
+    std::queue<T> queue_;
+  };
+};
+
+/* signal() and run_once() are called from the same thread, no locking */
+struct SingleThreadQueuePolicy {
+  static const bool THREAD_SAFE = false;
+  using Mutex = detail::NullMutex;
+  template <typename T> class Queue {
+  public:
+    void push(const T &value) { queue_.push(value); }
+    bool pop(T &value) {
+      if (queue_.empty()) {
+        return false;
+      }
+      value = queue_.front();
+      queue_.pop();
+      return true;
+    }
+
+  private:
+    std::queue<T> queue_;
+  };
+};
+
+/*
+ * reporter policy: static const bool FRAME_REPORT, bool enabled() and
+ * void report(const std::vector<StatusMonitorReport> &)
+ */
+/* runtime settable callback, FrameReport false drops per frame reports */
+template <bool FrameReport = true> class CallbackReporterPolicy {
+public:
+  static const bool FRAME_REPORT = FrameReport;
+  bool enabled() const { return static_cast<bool>(callback_); }
+  void report(
+      const std::vector<StatusMonitorAbstract::StatusMonitorReport> &reports) {
+    callback_(reports);
+  }
+  void set_reporter_callback(
+      StatusMonitorAbstract::StatusMonitorReporterCallback callback) {
+    callback_ = callback;
+  }
+
+private:
+  StatusMonitorAbstract::StatusMonitorReporterCallback callback_ = nullptr;
+};
+
+/* single reporter fixed at build time, called directly */
+template <void (*Reporter)(
+              const std::vector<StatusMonitorAbstract::StatusMonitorReport> &),
+          bool FrameReport = true>
+struct FunctionReporterPolicy {
+  static const bool FRAME_REPORT = FrameReport;
+  bool enabled() const { return true; }
+  void report(
+      const std::vector<StatusMonitorAbstract::StatusMonitorReport> &reports) {
+    Reporter(reports);
+  }
+};
+
+/* no reporter, report generation is compiled out */
+struct NullReporterPolicy {
+  static const bool FRAME_REPORT = false;
+  bool enabled() const { return false; }
+  void report(const std::vector<StatusMonitorAbstract::StatusMonitorReport> &) {
+  }
+};
+
+/*
+ * pipeline capacity policy: Pipelines with PipelineHandler *find(name),
+ * PipelineHandler *insert(name) (nullptr when full) and for_each(f)
+ */
+/* any number of pipelines */
+struct DynamicPipelinePolicy {
+  class Pipelines {
+  public:
+    detail::PipelineHandler *find(const std::string &name) {
+      std::map<std::string, detail::PipelineHandler>::iterator iter =
+          pipelines_.find(name);
+      return iter == pipelines_.end() ? nullptr : &iter->second;
+    }
+    detail::PipelineHandler *insert(const std::string &name) {
+      return &pipelines_[name];
+    }
+    template <typename F> void for_each(F f) {
+      for (auto &pipeline : pipelines_) {
+        f(pipeline.second);
+      }
+    }
+
+  private:
+    std::map<std::string, detail::PipelineHandler> pipelines_;
+  };
+};
+
+/* at most N pipelines, e.g. fixed camera count. fixed contiguous storage,
+ * no node allocation at registration */
+template <size_t N> struct FixedPipelinePolicy {
+  class Pipelines {
+  public:
+    detail::PipelineHandler *find(const std::string &name) {
+      for (size_t i = 0; i < size_; i++) {
+        if (handlers_[i].meta.pipeline_name == name) {
+          return &handlers_[i];
+        }
+      }
+      return nullptr;
+    }
+    detail::PipelineHandler *insert(const std::string &name) {
+      detail::PipelineHandler *handler = find(name);
+      if (handler == nullptr && size_ < N) {
+        handler = &handlers_[size_++];
+        handler->meta.pipeline_name = name;
+      }
+      return handler;
+    }
+    template <typename F> void for_each(F f) {
+      for (size_t i = 0; i < size_; i++) {
+        f(handlers_[i]);
+      }
+    }
+
+  private:
+    std::array<detail::PipelineHandler, N> handlers_;
+    size_t size_ = 0;
+  };
+};
+
+template <typename ClockPolicy = SteadyClockPolicy,
+          typename QueuePolicy = MutexQueuePolicy,
+          typename ReporterPolicy = CallbackReporterPolicy<>,
+          typename PipelinePolicy = DynamicPipelinePolicy>
+class StatusMonitorTemplate {
+public:
+  using PipelineInformation = StatusMonitorAbstract::PipelineInformation;
+  using StatusMonitorFrame = StatusMonitorAbstract::StatusMonitorFrame;
+  using StatusSignalWarning = StatusMonitorAbstract::StatusSignalWarning;
+  using StatusMonitorWarning = StatusMonitorAbstract::StatusMonitorWarning;
+  using StatusMonitorReport = StatusMonitorAbstract::StatusMonitorReport;
+
+  StatusMonitorTemplate() = default;
+  ~StatusMonitorTemplate() {
+    if (running_thread_ && running_thread_->joinable()) {
+      stop();
+    }
+  }
+  StatusMonitorTemplate(const StatusMonitorTemplate &) = delete;
+  StatusMonitorTemplate &operator=(const StatusMonitorTemplate &) = delete;
+
+  void run_once() {
+    uint64_t micros_now = ClockPolicy::now_us();
+    wall_time_us_ = ClockPolicy::wall_time_us();
+    StatusMonitorFrame signal;
+    StatusMonitorWarning signal_warning;
+
+    /* process frame queue */
+    while (frame_queue_.pop(signal)) {
+      std::lock_guard<typename QueuePolicy::Mutex> lg(pipelines_lock_);
+      PipelineHandler *handler = pipelines_.find(signal.pipeline_name);
+      if (handler != nullptr) {
+        process_frame(signal, *handler, micros_now);
+      }
+    }
+    /* process warning queue */
+    while (warning_queue_.pop(signal_warning)) {
+      std::lock_guard<typename QueuePolicy::Mutex> lg(pipelines_lock_);
+      PipelineHandler *handler = pipelines_.find(signal_warning.pipeline_name);
+      if (handler != nullptr) {
+        handler->camera_status_set.insert(signal_warning);
+      }
+    }
+
+    /* calculate and generate report */
+    bool timestamp_rollback = micros_now < last_run_time_us_;
+    last_run_time_us_ = micros_now;
+    if (heartbeat_origin_us_ == 0 || timestamp_rollback) {
+      /* heart beats of all pipelines are scheduled from one origin */
+      heartbeat_origin_us_ = micros_now;
+    }
+
+    std::vector<StatusMonitorReport> reports;
+    std::lock_guard<typename QueuePolicy::Mutex> lg(pipelines_lock_);
+    pipelines_.for_each([&](PipelineHandler &handler) {
+      process_pipeline(handler, micros_now, timestamp_rollback, reports);
+    });
+    if (reporter_.enabled() && reports.size() > 0) {
+      reporter_.report(reports);
+    }
+  }
+
+  void run_forever() {
+    static_assert(QueuePolicy::THREAD_SAFE,
+                  "run_forever needs a thread safe queue policy, call "
+                  "run_once from the signal thread instead");
+    is_quit_ = false;
+    running_thread_ =
+        std::make_shared<std::thread>(&StatusMonitorTemplate::runner, this);
+    pthread_setname_np(running_thread_->native_handle(),
+                       "status_monitor_thread");
+  }
+
+  void stop() {
+    is_quit_ = true;
+    if (running_thread_ && running_thread_->joinable()) {
+      running_thread_->join();
+    } else {
+      printf("fail to stop status monitor runner");
+    }
+  }
+
+  void pipeline_registration(PipelineInformation meta) {
+    if ((meta.fps <= 0) || (meta.fps > detail::PIPELINE_MAX_FPS)) {
+      printf("pipeline registration with illigal fps %d, set to default %d\n",
+             meta.fps, detail::PIPELINE_DEFAULT_FPS);
+      meta.fps = detail::PIPELINE_DEFAULT_FPS;
+    }
+
+    std::lock_guard<typename QueuePolicy::Mutex> lg(pipelines_lock_);
+    PipelineHandler *handler = pipelines_.insert(meta.pipeline_name);
+    if (handler == nullptr) {
+      printf("pipeline registration of %s exceeds pipeline capacity\n",
+             meta.pipeline_name.c_str());
+      return;
+    }
+    handler->meta = meta;
+    handler->frame_interval_us = 1000000.0 / meta.fps;
+    handler->sync_tolerance_us = meta.sync_tolerance_us;
+    if (handler->sync_tolerance_us == 0) {
+      /* keep tolerance well inside the frame interval for high fps */
+      handler->sync_tolerance_us = std::min<uint64_t>(
+          detail::DEFAULT_SYNC_TOLERANCE_US, handler->frame_interval_us / 4);
+    }
+    handler->heartbeat_period_us = meta.heartbeat_period_us;
+    if (handler->heartbeat_period_us == 0) {
+      handler->heartbeat_period_us = detail::DEFAULT_HEARTBEAT_PERIOD_US;
+    }
+  }
+
+  void signal(const StatusMonitorFrame &signal) { frame_queue_.push(signal); }
+
+  void signal(const StatusSignalWarning &signal) {
+    StatusMonitorWarning status_warning;
+    if (detail::Conv_Signal2Status(signal, status_warning)) {
+      warning_queue_.push(status_warning);
+    }
+  }
+
+  ReporterPolicy &reporter() { return reporter_; }
+
+private:
+  using PipelineHandler = detail::PipelineHandler;
+
+  void runner() {
+    while (!is_quit_) {
+      usleep(100);
+      run_once();
+    }
+    printf("status monitor runner quit");
+  }
+
+  static float precision(float f, int places) {
+    float n = std::pow(10.0f, places);
+    return std::round(f * n) / n;
+  }
+
+  void process_frame(const StatusMonitorFrame &signal, PipelineHandler &handler,
+                     uint64_t micros_now) {
+    if (handler.pipeline_start_time_us == 0) {
+      handler.pipeline_start_time_us = handler.frame_count_start_time_us =
+          micros_now;
+    }
+    // calculate frame sync from consecutive receive timestamps, frames
+    // drained in the same run_once share micros_now. without a receive
+    // timestamp fall back to the drain time
+    uint64_t sync_timestamp_us = signal.receive_timestamp_us > 0
+                                     ? signal.receive_timestamp_us
+                                     : micros_now;
+    if (handler.last_sync_timestamp_us > 0) {
+      double timestamp_diff =
+          (double)sync_timestamp_us - handler.last_sync_timestamp_us;
+      handler.sync = fabs(timestamp_diff - handler.frame_interval_us) <=
+                     handler.sync_tolerance_us;
+    }
+    handler.last_sync_timestamp_us = sync_timestamp_us;
+    handler.delay_us = signal.receive_timestamp_us - signal.sensor_timestamp_us;
+
+    handler.frame_count++;
+    handler.seq++;
+    handler.online = true;
+    handler.latest_frame_timestamp_us = micros_now;
+    if (ReporterPolicy::FRAME_REPORT && reporter_.enabled()) {
+      std::vector<StatusMonitorReport> reports;
+      StatusMonitorReport report;
+      report.report_type = StatusMonitorReport::FRAME;
+      report.seq = handler.seq;
+      report.pipeline_name = signal.pipeline_name;
+      report.sensor_timestamp_us = signal.sensor_timestamp_us;
+      report.publish_timestamp_us = wall_time_us_;
+      reports.emplace_back(report);
+      reporter_.report(reports);
+    }
+  }
+
+  void warning_report(const PipelineHandler &handler,
+                      StatusMonitorAbstract::STATUS_MONITOR_WARNING warning,
+                      std::vector<StatusMonitorReport> &reports) {
+    StatusMonitorReport report;
+    report.report_type = StatusMonitorReport::WARNING;
+    report.pipeline_name = handler.meta.pipeline_name;
+    report.width = handler.meta.width;
+    report.height = handler.meta.height;
+    report.bitrate = precision(handler.meta.bitrate, 2);
+    report.warning = warning;
+    report.receive_timestamp_us = wall_time_us_;
+    report.publish_timestamp_us = wall_time_us_;
+    reports.emplace_back(report);
+  }
+
+  void process_pipeline(PipelineHandler &handler, uint64_t micros_now,
+                        bool timestamp_rollback,
+                        std::vector<StatusMonitorReport> &reports) {
+    if (timestamp_rollback) {
+      /* systemtime time rollback warning */
+      /* refresh start time */
+      handler.pipeline_start_time_us = handler.frame_count_start_time_us =
+          micros_now;
+      if (reporter_.enabled()) {
+        warning_report(handler, StatusMonitorAbstract::SM_TIMESTAMP_ROLLBACK,
+                       reports);
+      }
+      handler.heartbeat_slot = 0;
+      return;
+    }
+
+    auto frame_diff = (micros_now - handler.latest_frame_timestamp_us);
+    if (frame_diff >= 2 * handler.frame_interval_us) {
+      /* frame loss warning */
+      handler.online = false;
+      if (reporter_.enabled()) {
+        warning_report(handler, StatusMonitorAbstract::SM_FRAME_LOSS, reports);
+      }
+      handler.latest_frame_timestamp_us = micros_now;
+    }
+    /* pipelines with the same period cross a slot in the same run_once and
+     * land in one report vector */
+    uint64_t heartbeat_slot =
+        (micros_now - heartbeat_origin_us_) / handler.heartbeat_period_us;
+    if (heartbeat_slot == handler.heartbeat_slot) {
+      return;
+    }
+    if (reporter_.enabled()) {
+      heartbeat_report(handler, micros_now, reports);
+    }
+    handler.heartbeat_slot = heartbeat_slot;
+  }
+
+  void heartbeat_report(PipelineHandler &handler, uint64_t micros_now,
+                        std::vector<StatusMonitorReport> &reports) {
+    StatusMonitorReport report;
+    report.report_type = StatusMonitorReport::HEART_BEAT;
+    report.pipeline_name = handler.meta.pipeline_name;
+    if (handler.seq > 0) {
+      double duration_us = micros_now - handler.frame_count_start_time_us;
+      report.fps = duration_us > 0
+                       ? handler.frame_count / (duration_us / 1000000)
+                       : 0.00;
+    } else {
+      report.fps = 0.00;
+    }
+    report.width = handler.meta.width;
+    report.height = handler.meta.height;
+    report.bitrate = precision(handler.meta.bitrate, 2);
+    report.publish_timestamp_us = wall_time_us_;
+    uint32_t logical_frames_total = 0;
+    if (handler.pipeline_start_time_us > 0) {
+      logical_frames_total = round(
+          (handler.meta.fps *
+           ((double)(micros_now - handler.pipeline_start_time_us) / 1000000)));
+    }
+    /* frames ahead of the nominal rate are not lost */
+    uint32_t losted_frames = logical_frames_total > handler.seq
+                                 ? logical_frames_total - handler.seq
+                                 : 0;
+    if (handler.seq > 0) {
+      if (losted_frames > 0) {
+        report.frame_loss = std::to_string(losted_frames) + "/" +
+                            std::to_string(logical_frames_total);
+      } else {
+        report.frame_loss =
+            std::to_string(0) + "/" + std::to_string(logical_frames_total);
+      }
+    } else {
+      report.frame_loss = std::to_string(logical_frames_total) + "/" +
+                          std::to_string(logical_frames_total);
+    }
+    report.online = handler.online;
+    report.sync = handler.sync;
+    report.delay_us = handler.delay_us;
+    reports.emplace_back(report);
+
+    if ((micros_now - handler.frame_count_start_time_us) > 1000 * 1000 * 60) {
+      /* reset fps calculate duration */
+      handler.frame_count = 0;
+      handler.frame_count_start_time_us = micros_now;
+    }
+    /* set status in reports*/
+    for (auto it = handler.camera_status_set.begin();
+         it != handler.camera_status_set.end();) {
+      StatusMonitorReport report;
+      report.report_type = StatusMonitorReport::WARNING;
+      report.pipeline_name = it->pipeline_name;
+      report.receive_timestamp_us = it->timestamp_us;
+      report.publish_timestamp_us = wall_time_us_;
+      report.warning = it->warning;
+      report.width = handler.meta.width;
+      report.height = handler.meta.height;
+      reports.emplace_back(report);
+      if (it->warning == StatusMonitorAbstract::SM_STATUS_OK) {
+        handler.camera_status_set.clear();
+        break;
+      } else if (it->warning == StatusMonitorAbstract::SM_ENCODE_ERROR) {
+        handler.camera_status_set.erase(it++);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  std::shared_ptr<std::thread> running_thread_ = nullptr;
+  std::atomic<bool> is_quit_{false};
+  uint64_t last_run_time_us_ = 0;
+  uint64_t heartbeat_origin_us_ = 0;
+  uint64_t wall_time_us_ = 0; // sampled once per run_once, for reports
+  typename QueuePolicy::Mutex pipelines_lock_;
+  typename PipelinePolicy::Pipelines pipelines_;
+  typename QueuePolicy::template Queue<StatusMonitorFrame> frame_queue_;
+  typename QueuePolicy::template Queue<StatusMonitorWarning> warning_queue_;
+  ReporterPolicy reporter_;
+};
+} // namespace CameraService
@@ -0,0 +1,108 @@
+/*****************************************************************************
+ * Copyright (C) 2022 Momenta Technology Co., Ltd. All rights reserved.
+ *
+ * No.58 Qinglonggang Rd, Suzhou, Jiangsu, PR China, contact@momenta.ai
+ *
+ * https://www.momenta.cn/
+ *
+ * Filename         : status_monitor_example.cpp
+ * Description      : StatusMonitorTemplate with non default policies, driven
+ *                    by a manual clock
+ *****************************************************************************/
+#include "status_monitor_template.h"
+#include <cstdio>
+#include <vector>
+
+using namespace CameraService;
+
+/* settable clock for single thread monitors, no real sleeps. process wide
+ * and unsynchronized, never pair it with run_forever */
+struct ManualClockPolicy {
+  static uint64_t now_us() { return time_us(); }
+  static uint64_t wall_time_us() { return time_us(); }
+  static void set_us(uint64_t t) { time_us() = t; }
+  static void advance_us(uint64_t d) { time_us() += d; }
+
+private:
+  static uint64_t &time_us() {
+    static uint64_t t = 0;
+    return t;
+  }
+};
+
+namespace CameraService {
+/* threaded build time configuration: fixed camera count, no frame reports */
+template class StatusMonitorTemplate<SteadyClockPolicy, MutexQueuePolicy,
+                                     CallbackReporterPolicy<false>,
+                                     FixedPipelinePolicy<4>>;
+} // namespace CameraService
+
+void std_reporter(
+    const std::vector<StatusMonitorAbstract::StatusMonitorReport> &reports) {
+  for (const auto &report : reports) {
+    if (report.report_type ==
+        StatusMonitorAbstract::StatusMonitorReport::HEART_BEAT) {
+      printf("report pipeline %s, fps = %.2f, frame_loss = %s, sync = %s, "
+             "online = %s\n",
+             report.pipeline_name.c_str(), report.fps,
+             report.frame_loss.c_str(), report.sync == true ? "true" : "false",
+             report.online == true ? "true" : "false");
+    } else if (report.report_type ==
+               StatusMonitorAbstract::StatusMonitorReport::WARNING) {
+      printf("report pipeline %s warning[%d]\n", report.pipeline_name.c_str(),
+             report.warning);
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+  /* single thread, one reporter fixed at build time, two cameras */
+  StatusMonitorTemplate<ManualClockPolicy, SingleThreadQueuePolicy,
+                        FunctionReporterPolicy<std_reporter, false>,
+                        FixedPipelinePolicy<2>>
+      monitor;
+  /* same pipelines, report generation compiled out */
+  StatusMonitorTemplate<ManualClockPolicy, SingleThreadQueuePolicy,
+                        NullReporterPolicy, FixedPipelinePolicy<2>>
+      silent_monitor;
+
+  ManualClockPolicy::set_us(1000000);
+  StatusMonitorAbstract::PipelineInformation meta;
+  meta.fps = 240;
+  meta.heartbeat_period_us = 500 * 1000;
+  meta.pipeline_name = "front_wide";
+  monitor.pipeline_registration(meta);
+  silent_monitor.pipeline_registration(meta);
+  meta.pipeline_name = "front_far";
+  monitor.pipeline_registration(meta);
+  silent_monitor.pipeline_registration(meta);
+
+  /* 2 seconds of 240 fps, front_far drops every 4th frame */
+  StatusMonitorAbstract::StatusMonitorFrame signal;
+  const uint64_t frame_interval_us = 1000000 / 240;
+  for (uint32_t count = 0; count < 480; count++) {
+    ManualClockPolicy::advance_us(frame_interval_us);
+    signal.sensor_timestamp_us = ManualClockPolicy::wall_time_us();
+    signal.receive_timestamp_us = signal.sensor_timestamp_us + 200;
+    signal.pipeline_name = "front_wide";
+    monitor.signal(signal);
+    silent_monitor.signal(signal);
+    if (0 != count % 4) {
+      signal.pipeline_name = "front_far";
+      monitor.signal(signal);
+      silent_monitor.signal(signal);
+    }
+    monitor.run_once();
+    silent_monitor.run_once();
+  }
+
+  /* front_far goes silent, frame loss warning on the next run */
+  ManualClockPolicy::advance_us(10 * frame_interval_us);
+  signal.sensor_timestamp_us = ManualClockPolicy::wall_time_us();
+  signal.receive_timestamp_us = signal.sensor_timestamp_us + 200;
+  signal.pipeline_name = "front_wide";
+  monitor.signal(signal);
+  monitor.run_once();
+
+  return 0;
+}